@@ -0,0 +1,194 @@
+#pragma once
+
+#include "framebuffer.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// Edge-avoiding a-trous wavelet filter (Dammertz et al. 2010), with the variance guided color weight from SVGF (Schied et al. 2017)
+// each pass blurs with a 5x5 B3 spline kernel whose taps are spread 2^pass pixels apart, so a few passes cover a large radius cheaply
+// every tap is weighted by how similar its albedo, normal and depth are to the center pixel, so edges between objects stay sharp,
+// and by how different its color is compared to the noise we expect there, so real detail (reflections, shadows) is kept too
+// defaults were tuned on random_scene() at 4-16 spp against 500 spp renders ; more passes blur away contact shadows,
+// which the features cannot tell apart from lit floor
+struct denoiser_settings {
+    int passes = 2;
+    double sigma_luminance = 2.0; // how many standard deviations of noise a luminance difference may be
+    double sigma_albedo = 0.1;
+    double sigma_normal = 0.6;
+    double sigma_depth = 1.0;     // in units of the local depth gradient, so slanted surfaces (the floor) still blur
+    unsigned int threads = 0;     // 0 == use std::thread::hardware_concurrency()
+};
+
+class denoiser {
+public:
+    denoiser() {}
+    denoiser(const denoiser_settings& s) : settings(s) {}
+
+    // filters fb.pixels in place, the feature buffers are only read
+    void apply(framebuffer& fb) const {
+        const size_t count = fb.pixels.size();
+        if (count == 0)
+            return;
+
+        // divide out the albedo, so the filter only blurs the lighting and not texture detail, multiplied back in at the end
+        // the variance is scaled the same way, it was measured on the color before demodulation
+        std::vector<color> irradiance(count);
+        std::vector<double> variance(count);
+        for (size_t i = 0; i < count; ++i) {
+            irradiance[i] = demodulate(fb.pixels[i], fb.albedo[i]);
+            double albedo_luminance = luminance(fb.albedo[i]) + albedo_epsilon;
+            variance[i] = fb.variance[i] / (albedo_luminance * albedo_luminance);
+        }
+
+        // how fast the depth changes around each pixel, the depth weight is relative to it
+        // the smaller one sided difference is used, so a pixel at the silhouette of an object measures its own surface and not the jump behind it
+        std::vector<double> depth_gradient(count);
+        for (int row = 0; row < fb.height; ++row) {
+            for (int col = 0; col < fb.width; ++col) {
+                auto depth_at = [&](int x, int y) {
+                    return fb.depth[fb.index(clamp_int(x, 0, fb.width - 1), clamp_int(y, 0, fb.height - 1))];
+                };
+                const double d = depth_at(col, row);
+                double dx = std::min(std::fabs(depth_at(col + 1, row) - d), std::fabs(d - depth_at(col - 1, row)));
+                double dy = std::min(std::fabs(depth_at(col, row + 1) - d), std::fabs(d - depth_at(col, row - 1)));
+                depth_gradient[fb.index(col, row)] = std::max(dx, dy);
+            }
+        }
+
+        std::vector<color> filtered(count);
+        std::vector<double> filtered_variance(count);
+
+        for (int pass = 0; pass < settings.passes; ++pass) {
+            const int step = 1 << pass;
+            for_each_row_parallel(fb.height, [&](int row) {
+                filter_row(fb, depth_gradient, irradiance, variance, filtered, filtered_variance, row, step);
+            });
+            irradiance.swap(filtered);
+            variance.swap(filtered_variance);
+        }
+
+        for (size_t i = 0; i < count; ++i)
+            fb.pixels[i] = remodulate(irradiance[i], fb.albedo[i]);
+    }
+
+public:
+    denoiser_settings settings;
+
+private:
+    static constexpr double albedo_epsilon = 1e-3;
+    static constexpr double depth_epsilon = 1e-3;
+
+    static color demodulate(const color& c, const color& albedo) {
+        return color(c.x() / (albedo.x() + albedo_epsilon),
+                     c.y() / (albedo.y() + albedo_epsilon),
+                     c.z() / (albedo.z() + albedo_epsilon));
+    }
+
+    static color remodulate(const color& c, const color& albedo) {
+        return c * (albedo + color(albedo_epsilon, albedo_epsilon, albedo_epsilon));
+    }
+
+    // 3x3 gaussian blur of the variance around a pixel, a handful of samples gives a very noisy variance estimate on its own
+    static double blurred_variance(const framebuffer& fb, const std::vector<double>& variance, int col, int row) {
+        static const double kernel[3] = { 0.25, 0.5, 0.25 };
+        double sum = 0.0;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx) {
+                const int x = clamp_int(col + dx, 0, fb.width - 1);
+                const int y = clamp_int(row + dy, 0, fb.height - 1);
+                sum += kernel[dx + 1] * kernel[dy + 1] * variance[fb.index(x, y)];
+            }
+        return sum;
+    }
+
+    void filter_row(const framebuffer& fb, const std::vector<double>& depth_gradient,
+                    const std::vector<color>& in, const std::vector<double>& in_variance,
+                    std::vector<color>& out, std::vector<double>& out_variance,
+                    int row, int step) const
+    {
+        // B3 spline, separable weights for offsets -2..2
+        static const double kernel[5] = { 1.0 / 16, 1.0 / 4, 3.0 / 8, 1.0 / 4, 1.0 / 16 };
+
+        // the sigmas are squared once here instead of in the inner loop
+        const double inv_albedo = 1.0 / (settings.sigma_albedo * settings.sigma_albedo);
+        const double inv_normal = 1.0 / (settings.sigma_normal * settings.sigma_normal);
+
+        for (int col = 0; col < fb.width; ++col) {
+            const size_t p = fb.index(col, row);
+            const double l_p = luminance(in[p]);
+            const color& a_p = fb.albedo[p];
+            const vec3& n_p = fb.normal[p];
+            const double d_p = fb.depth[p];
+
+            // differences smaller than a few standard deviations of the noise are treated as the same color
+            const double luminance_scale = 1.0 / (settings.sigma_luminance * std::sqrt(blurred_variance(fb, in_variance, col, row)) + 1e-6);
+
+            color sum(0, 0, 0);
+            double weight_sum = 0.0;
+            double variance_sum = 0.0;
+
+            for (int dy = -2; dy <= 2; ++dy) {
+                // clamp to the edge of the image
+                const int y = clamp_int(row + dy * step, 0, fb.height - 1);
+                for (int dx = -2; dx <= 2; ++dx) {
+                    const int x = clamp_int(col + dx * step, 0, fb.width - 1);
+                    const size_t q = fb.index(x, y);
+
+                    // the depth gradient is per pixel, so the allowed depth difference grows with the distance to the tap
+                    const double tap_distance = step * std::sqrt(double(dx * dx + dy * dy));
+                    const double depth_scale = 1.0 / (settings.sigma_depth * depth_gradient[p] * tap_distance + depth_epsilon);
+
+                    const double dist_luminance = std::fabs(luminance(in[q]) - l_p);
+                    const double dist_albedo = (fb.albedo[q] - a_p).length_squared();
+                    const double dist_normal = (fb.normal[q] - n_p).length_squared();
+                    const double dist_depth = std::fabs(fb.depth[q] - d_p);
+
+                    // product of the weights == exp of the sum, one exp per tap instead of four
+                    const double w = kernel[dx + 2] * kernel[dy + 2] * std::exp(-(
+                        dist_luminance * luminance_scale +
+                        dist_albedo * inv_albedo +
+                        dist_normal * inv_normal +
+                        dist_depth * depth_scale));
+
+                    sum += w * in[q];
+                    weight_sum += w;
+                    variance_sum += w * w * in_variance[q];
+                }
+            }
+
+            // the center tap always has weight > 0, so this never divides by zero
+            out[p] = sum / weight_sum;
+            // averaging shrinks the noise too, the next pass needs to know how much is left
+            out_variance[p] = variance_sum / (weight_sum * weight_sum);
+        }
+    }
+
+    static int clamp_int(int x, int min, int max) {
+        return x < min ? min : (x > max ? max : x);
+    }
+
+    // rows are independent within a pass, so split them across threads with interleaved rows to balance the work
+    template <typename Func>
+    void for_each_row_parallel(int height, Func func) const {
+        unsigned int thread_count = settings.threads ? settings.threads : std::thread::hardware_concurrency();
+        thread_count = std::max(1u, std::min(thread_count, static_cast<unsigned int>(height)));
+
+        if (thread_count == 1) {
+            for (int row = 0; row < height; ++row)
+                func(row);
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < thread_count; ++t) {
+            workers.emplace_back([=, &func]() {
+                for (int row = static_cast<int>(t); row < height; row += static_cast<int>(thread_count))
+                    func(row);
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+    }
+};
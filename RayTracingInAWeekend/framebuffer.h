@@ -0,0 +1,49 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include <vector>
+
+// features of the first surface a camera ray hits, these are much less noisy than the color and guide the denoiser
+struct hit_features {
+    color albedo;  // base color of the material hit (background color on a miss)
+    vec3 normal;   // shading normal at the hit point (zero on a miss)
+    double depth = 0.0; // distance along the ray to the hit (zero on a miss)
+};
+
+inline double luminance(const color& c) {
+    return 0.2126 * c.x() + 0.7152 * c.y() + 0.0722 * c.z();
+}
+
+class framebuffer {
+public:
+    framebuffer() {}
+    framebuffer(int w, int h)
+        : width(w), height(h),
+          pixels(size_t(w) * h), albedo(size_t(w) * h), normal(size_t(w) * h), depth(size_t(w) * h, 0.0),
+          variance(size_t(w) * h, 0.0)
+    {}
+
+    // row 0 is the top of the image, same order as the ppm is written in
+    size_t index(int col, int row) const { return size_t(row) * width + col; }
+
+    void set(int col, int row, const color& pixel_color, const hit_features& features, double pixel_variance) {
+        size_t i = index(col, row);
+        pixels[i] = pixel_color;
+        albedo[i] = features.albedo;
+        normal[i] = features.normal;
+        depth[i] = features.depth;
+        variance[i] = pixel_variance;
+    }
+
+public:
+    int width = 0;
+    int height = 0;
+
+    // all buffers hold the per pixel average over samples, in linear space (before gamma)
+    std::vector<color> pixels;
+    std::vector<color> albedo;
+    std::vector<vec3> normal;
+    std::vector<double> depth;
+    std::vector<double> variance; // variance of the pixel's mean luminance, tells the denoiser how much of a difference is just noise
+};
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "renderer.h"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reads render jobs from a text file, one job per line, '#' starts a comment:
+//   output lookfrom_x lookfrom_y lookfrom_z lookat_x lookat_y lookat_z vfov image_width samples_per_pixel [seed] [denoise]
+// anything not on the line (aperture, focus distance, depth, ...) keeps the render_job default
+bool load_jobs(std::istream& in, std::vector<render_job>& jobs)
+{
+    std::string line;
+    int line_number = 0;
+    while (std::getline(in, line))
+    {
+        ++line_number;
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+
+        render_job job;
+        if (!(fields >> job.output))
+            continue; // blank or comment line
+
+        double fx, fy, fz, ax, ay, az;
+        if (!(fields >> fx >> fy >> fz >> ax >> ay >> az >> job.vfov >> job.image_width >> job.samples_per_pixel))
+        {
+            std::cerr << "job file line " << line_number << ": expected output lookfrom(x y z) lookat(x y z) vfov width spp [seed] [denoise]\n";
+            return false;
+        }
+        job.lookfrom = point3(fx, fy, fz);
+        job.lookat = point3(ax, ay, az);
+
+        // anything that would make the camera or the pixel coordinates divide by zero turns the whole image into NaN
+        const char* problem = nullptr;
+        if (job.image_height() < 2) // pixel_v divides by image_height - 1
+            problem = "image is less than 2 pixels high";
+        else if (job.samples_per_pixel < 1)
+            problem = "samples_per_pixel must be at least 1";
+        else if (!(job.vfov > 0 && job.vfov < 180))
+            problem = "vfov must be between 0 and 180 degrees";
+        else if ((job.lookfrom - job.lookat).near_zero())
+            problem = "lookfrom and lookat are the same point";
+        else if (cross(job.vup, job.lookfrom - job.lookat).near_zero())
+            problem = "camera looks straight along the up vector";
+        // a typo in the path should fail now, not after the job has rendered ; append so an existing file is left as it is
+        else if (job.output != "-" && !std::ofstream(job.output, std::ios::app))
+            problem = "cannot open the output file";
+
+        if (problem)
+        {
+            std::cerr << "job file line " << line_number << ": " << problem << '\n';
+            return false;
+        }
+        // default the seed to the job index so every job is reproducible on its own
+        job.seed = static_cast<unsigned int>(jobs.size());
+
+        std::string option;
+        while (fields >> option)
+        {
+            std::istringstream number(option);
+            unsigned int seed;
+            if (option == "denoise")
+                job.denoise = true;
+            else if (option.find_first_not_of("0123456789") == std::string::npos && number >> seed)
+                job.seed = seed;
+            else
+            {
+                std::cerr << "job file line " << line_number << ": unknown option " << option << '\n';
+                return false;
+            }
+        }
+
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+
+// Renders many jobs of the same scene on one pool of threads
+// the scene is built once by the caller and only read while rendering, so all jobs share it
+// work is handed out a row at a time across all jobs, so threads never sit idle waiting for one job to finish
+class job_runner {
+public:
+    job_runner(const hittable& w, unsigned int thread_count = 0) : world(w), threads(thread_count) {}
+
+    void add(const render_job& job) { jobs.push_back(std::make_unique<job_state>(job)); }
+
+    // returns the number of jobs whose output could not be written
+    int run() {
+        // rows of all jobs in one list, job after job, so the first jobs finish (and free their memory) first
+        // and only the few jobs in flight hold a framebuffer at any time
+        std::vector<int> first_row;
+        int total_rows = 0;
+        for (const auto& state : jobs) {
+            first_row.push_back(total_rows);
+            total_rows += state->job.image_height();
+        }
+        rows_remaining = total_rows;
+
+        unsigned int thread_count = threads ? threads : std::thread::hardware_concurrency();
+        if (thread_count == 0)
+            thread_count = 1;
+
+        std::atomic<int> next_row(0);
+        std::atomic<int> idle_workers(0);
+        auto worker = [&]() {
+            while (true) {
+                int task = next_row++;
+                if (task >= total_rows) {
+                    ++idle_workers;
+                    return;
+                }
+
+                // find the job this row belongs to
+                size_t j = 0;
+                while (j + 1 < jobs.size() && first_row[j + 1] <= task)
+                    ++j;
+                job_state& state = *jobs[j];
+
+                // the first thread to get a row of the job allocates its framebuffer, any other thread on the same job waits for it
+                std::call_once(state.allocated, [&]() { state.fb = framebuffer(state.job.image_width, state.job.image_height()); });
+
+                render_row(world, state.cam, state.job, state.fb, task - first_row[j]);
+                report_progress();
+
+                // whoever renders the last row of a job finishes it
+                // the denoiser gets this thread plus the workers that ran out of rows and exited ; taking them all with exchange
+                // means two jobs finishing at once never share the same idle threads, so the pool is never oversubscribed
+                if (--state.rows_left == 0) {
+                    int borrowed = idle_workers.exchange(0);
+                    finish(state, 1 + borrowed);
+                    idle_workers += borrowed; // hand them back for jobs that finish later
+                }
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (unsigned int t = 0; t < thread_count; ++t)
+            workers.emplace_back(worker);
+        for (auto& w : workers)
+            w.join();
+
+        std::cerr << "\nDone.\n";
+        return failed_jobs;
+    }
+
+private:
+    struct job_state {
+        job_state(const render_job& j)
+            : job(j), cam(j.make_camera()), rows_left(j.image_height()) {}
+
+        render_job job;
+        camera cam;
+        framebuffer fb; // empty until the first row of the job is handed out
+        std::once_flag allocated;
+        std::atomic<int> rows_left;
+    };
+
+    void report_progress() {
+        int remaining = --rows_remaining;
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cerr << "\rScanlines remaining: " << remaining << ' ' << std::flush;
+    }
+
+    void finish(job_state& state, unsigned int denoise_threads) {
+        if (state.job.denoise) {
+            denoiser_settings settings;
+            settings.threads = denoise_threads;
+            denoiser(settings).apply(state.fb);
+        }
+
+        std::lock_guard<std::mutex> lock(output_mutex);
+        if (state.job.output == "-") {
+            write_ppm(std::cout, state.fb);
+            if (!std::cout) {
+                std::cerr << "\nfailed to write to stdout\n";
+                ++failed_jobs;
+            }
+        }
+        else {
+            std::ofstream file(state.job.output);
+            write_ppm(file, state.fb);
+            file.close(); // flushes, so a full disk shows up here and not silently in the destructor
+            if (!file) {
+                std::cerr << "\nfailed to write " << state.job.output << '\n';
+                ++failed_jobs;
+            }
+        }
+
+        // framebuffer is written, release it
+        state.fb = framebuffer();
+    }
+
+private:
+    const hittable& world;
+    unsigned int threads;
+    std::vector<std::unique_ptr<job_state>> jobs;
+    std::atomic<int> rows_remaining{ 0 };
+    std::atomic<int> failed_jobs{ 0 };
+    std::mutex output_mutex;
+};
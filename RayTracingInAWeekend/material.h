@@ -7,6 +7,12 @@ class material {
 public:
     // function to describe behavior of light after hitting object, should it bounce , if so how so
     virtual bool scatter( const ray& r_in, const hit_record& rec, color& attenuation, ray& scattered) const = 0;
+
+    // base color of the surface, written to the albedo buffer for the denoiser ; materials without a color (glass) let all light through
+    virtual color feature_albedo() const { return color(1.0, 1.0, 1.0); }
+
+    // mirror like materials show other surfaces instead of their own, the denoiser features are taken from the surface seen in them
+    virtual bool specular_features() const { return false; }
 };
 
 
@@ -33,6 +39,8 @@ public:
         return true;
     }
 
+    virtual color feature_albedo() const override { return albedo; }
+
 public:
     color albedo;
 };
@@ -55,6 +63,10 @@ public:
         return (dot(scattered.direction(), rec.normal) > 0);
     }
 
+    virtual color feature_albedo() const override { return albedo; }
+    // fuzzy metal blurs its reflection by itself, only a near perfect mirror shows sharp detail
+    virtual bool specular_features() const override { return fuzz < 0.05; }
+
 public:
     color albedo;
     double fuzz;
@@ -95,11 +107,12 @@ public:
         return true;
     }
 
+    virtual bool specular_features() const override { return true; }
+
 public:
     double ir; // Index of Refraction
 
 
-private:
     static double reflectance(double cosine, double ref_idx) {
         // Use Schlick's approximation for reflectance.
         auto r0 = (1 - ref_idx) / (1 + ref_idx);
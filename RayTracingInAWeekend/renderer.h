@@ -0,0 +1,161 @@
+#pragma once
+
+#include "rtweekend.h"
+
+#include "camera.h"
+#include "color.h"
+#include "denoiser.h"
+#include "framebuffer.h"
+#include "hittable.h"
+#include "material.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+color background_color(const ray& r) {
+    vec3 unit_direction = unit_vector(r.direction());
+    double height_percent = 0.5 * (unit_direction.y() + 1.0); // convert to [0,1] range from [-1,1]
+    return (1.0 - height_percent) * color(1.0, 1.0, 1.0) + height_percent * color(0.5, 0.7, 1.0); // linearly interporlate based off height
+}
+
+
+// features is only passed in for the camera ray, so it gets filled from the first hit and not from any of the bounces
+color ray_color(const ray& r, const hittable& world, int depth, hit_features* features = nullptr) {
+    hit_record rec;
+    
+    // if we reach max number of bounces, no more color is gathered
+    if (depth <= 0)
+    {
+        return color(0, 0, 0);
+    }
+
+
+    // avoid floating point error by making min = 0 + e ; makes reflected rays not hit the same object when bouncing
+    if (world.hit(r, 0.001, infinity, rec)) {
+        ray scattered;
+        color attenuation;
+        // if light bounces back , instead of getting absorbed ( bounces away from normal), get behavior based on material hit and the recursively bounce ray again
+        bool scatters = rec.mat_ptr->scatter(r, rec, attenuation, scattered);
+        double hit_distance = rec.t * r.direction().length();
+
+        if (features && scatters && rec.mat_ptr->specular_features())
+        {
+            // a mirror or glass shows whatever it reflects, so take the features from there, tinted by the mirror
+            hit_features seen;
+            color seen_color = attenuation * ray_color(scattered, world, depth - 1, &seen);
+            features->albedo = attenuation * seen.albedo;
+            features->normal = seen.normal;
+            features->depth = hit_distance + seen.depth;
+            return seen_color;
+        }
+
+        if (features)
+        {
+            features->albedo = rec.mat_ptr->feature_albedo();
+            features->normal = rec.normal;
+            features->depth = hit_distance;
+        }
+
+        if (scatters)
+            // instead of just returning the normal converted to a color, get new diffuse bounce direction and recursively bounce
+            return attenuation * ray_color(scattered, world, depth - 1);
+        return color(0, 0, 0);
+    }
+
+    // since this is diffuse, the only time this actually gets color is if it misses and get color from surounding background (and modulate )
+    //else  color background / miss
+    color background = background_color(r);
+    if (features)
+    {
+        features->albedo = background;
+        features->normal = vec3(0, 0, 0);
+        features->depth = 0.0;
+    }
+    return background;
+}
+
+
+// everything needed to render one image of a scene, the scene itself is shared between jobs
+struct render_job {
+    std::string output = "-"; // ppm file to write, "-" == stdout
+
+    // camera
+    point3 lookfrom = point3(13, 2, 3);
+    point3 lookat = point3(0, 0, 0);
+    vec3 vup = vec3(0, 1, 0);
+    double vfov = 20; // vertical field-of-view in degrees
+    double aperture = 0.1;
+    double focus_dist = 10.0;
+
+    // image
+    double aspect_ratio = 3.0 / 2.0; // == width / height
+    int image_width = 300;
+    int samples_per_pixel = 10;
+    int max_depth = 10;
+    bool denoise = false; // run the denoiser on the framebuffer before writing it out, opt in with --denoise or "denoise" in a job file
+    unsigned int seed = 0; // with the same seed a job renders the same image, whatever thread renders each row
+
+    int image_height() const { return static_cast<int>(image_width / aspect_ratio); } // == width * height / width
+
+    camera make_camera() const {
+        return camera(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, focus_dist);
+    }
+};
+
+
+// renders one row of the framebuffer (row 0 == top), rows are independent so they can go to any thread in any order
+void render_row(const hittable& world, const camera& cam, const render_job& job, framebuffer& fb, int fb_row)
+{
+    // every row gets its own random sequence, derived from the job seed, so the result does not depend on scheduling
+    seed_random(job.seed * 2654435761u + static_cast<unsigned int>(fb_row));
+
+    const int image_width = fb.width;
+    const int image_height = fb.height;
+    const int row = image_height - 1 - fb_row; // camera v goes bottom to top
+
+    for (int col = 0; col < image_width; ++col)
+    {
+        color pixel_color(0, 0, 0); // set inital color to zero
+        hit_features pixel_features;
+        double luminance_sum = 0.0;
+        double luminance_squared_sum = 0.0;
+        for (int s = 0; s < job.samples_per_pixel; ++s)
+        {
+            // get coordinates in pixel space, for current_pixel + some random vector whose components are [0,1]
+            double pixel_u = (col + random_double()) / (image_width - 1.0);
+            double pixel_v = (row + random_double()) / (image_height - 1.0);
+            // create a ray from camera origin, pointing to that pixel
+            ray r = cam.get_ray(pixel_u, pixel_v);
+            hit_features sample_features;
+            color sample_color = ray_color(r, world, job.max_depth, &sample_features);
+            pixel_color += sample_color; // for each sample add color
+
+            double sample_luminance = luminance(sample_color);
+            luminance_sum += sample_luminance;
+            luminance_squared_sum += sample_luminance * sample_luminance;
+
+            // average the features too, so they are anti-aliased along edges the same way the color is
+            pixel_features.albedo += sample_features.albedo;
+            pixel_features.normal += sample_features.normal;
+            pixel_features.depth += sample_features.depth;
+        }
+        // bring totals back to normal by weighting them 1 / samples_per_pixel
+        double scale = 1.0 / job.samples_per_pixel;
+        pixel_features.albedo *= scale;
+        pixel_features.normal *= scale;
+        pixel_features.depth *= scale;
+        // variance of one sample is E[x^2] - E[x]^2, the mean of n samples has 1/n of that
+        double mean_luminance = luminance_sum * scale;
+        double sample_variance = std::max(0.0, luminance_squared_sum * scale - mean_luminance * mean_luminance);
+        fb.set(col, fb_row, scale * pixel_color, pixel_features, sample_variance * scale);
+    }
+}
+
+
+void write_ppm(std::ostream& out, const framebuffer& fb)
+{
+    out << "P3\n" << fb.width << ' ' << fb.height << "\n255\n";
+    for (const color& pixel_color : fb.pixels)
+        write_color(out, pixel_color, 1); // already averaged
+}
@@ -16,9 +16,22 @@ inline double clamp(double x, double min, double max) {
 }
 
 
+inline std::mt19937& random_generator() {
+    // one generator per thread, rand() shares hidden state between threads and its output differs per compiler
+    // mt19937 is fully specified by the standard, so a seed gives the same numbers on every platform
+    thread_local std::mt19937 generator;
+    return generator;
+}
+
+inline void seed_random(unsigned int seed) {
+    // Reseeds the calling thread's generator, used to make renders reproducible no matter which thread renders which row
+    random_generator().seed(seed);
+}
+
 inline double random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    // uses the raw 32 bit output instead of std::uniform_real_distribution, whose algorithm is left to the implementation
+    return random_generator()() / 4294967296.0;
 }
 
 inline double random_double(double min, double max) {
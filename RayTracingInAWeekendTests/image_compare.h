@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <istream>
+#include <limits>
+#include <string>
+#include <vector>
+
+// 8 bit rgb image, as read from the P3 ppm files the renderer writes
+struct image {
+    int width = 0;
+    int height = 0;
+    std::vector<int> values; // r g b r g b ..., row 0 == top
+
+    double at(int col, int row, int channel) const { return values[(size_t(row) * width + col) * 3 + channel] / 255.0; }
+};
+
+bool read_ppm(std::istream& in, image& img)
+{
+    std::string magic;
+    int max_value = 0;
+    if (!(in >> magic >> img.width >> img.height >> max_value) || magic != "P3" || max_value != 255)
+        return false;
+
+    img.values.resize(size_t(img.width) * img.height * 3);
+    for (int& v : img.values)
+        if (!(in >> v))
+            return false;
+    return true;
+}
+
+
+// root mean squared error over all channels, in [0,1]
+double rmse(const image& a, const image& b)
+{
+    double sum = 0.0;
+    for (size_t i = 0; i < a.values.size(); ++i) {
+        double d = (a.values[i] - b.values[i]) / 255.0;
+        sum += d * d;
+    }
+    return std::sqrt(sum / a.values.size());
+}
+
+// peak signal to noise ratio in dB, infinity for identical images
+double psnr(const image& a, const image& b)
+{
+    double e = rmse(a, b);
+    if (e == 0.0)
+        return std::numeric_limits<double>::infinity();
+    return 20.0 * std::log10(1.0 / e);
+}
+
+
+// largest difference between the average of a color channel over the two images, in [0,1]
+// per pixel noise averages out over the whole image, so this picks up overall shifts in brightness or tint
+double mean_difference(const image& a, const image& b)
+{
+    double sum[3] = { 0.0, 0.0, 0.0 };
+    for (size_t i = 0; i < a.values.size(); ++i)
+        sum[i % 3] += (a.values[i] - b.values[i]) / 255.0;
+
+    const double pixels = double(a.width) * a.height;
+    return std::max(std::fabs(sum[0]), std::max(std::fabs(sum[1]), std::fabs(sum[2]))) / pixels;
+}
+
+
+// Simple perceptual error, loosely in the spirit of NVIDIA's FLIP: the per pixel difference is blurred with a 3x3 binomial filter
+// (the eye does not resolve single pixel noise), moved to an opponent color space (luminance, red-green, blue-yellow) and measured
+// as a weighted euclidean length, clamped to [0,1] ; returns the mean over all pixels, max_error is the worst pixel
+double perceptual_error(const image& a, const image& b, double* max_error = nullptr)
+{
+    // 3x3 binomial blur, weights 1 2 1 ; the blur is linear, so blurring the difference == difference of the blurs,
+    // and identical images come out as exactly zero
+    auto blurred_difference = [&](int col, int row, int channel) {
+        static const double kernel[3] = { 0.25, 0.5, 0.25 };
+        double sum = 0.0;
+        for (int dy = -1; dy <= 1; ++dy)
+            for (int dx = -1; dx <= 1; ++dx) {
+                int x = std::min(std::max(col + dx, 0), a.width - 1);
+                int y = std::min(std::max(row + dy, 0), a.height - 1);
+                sum += kernel[dx + 1] * kernel[dy + 1] * (a.at(x, y, channel) - b.at(x, y, channel));
+            }
+        return sum;
+    };
+
+    double sum = 0.0;
+    double worst = 0.0;
+    for (int row = 0; row < a.height; ++row) {
+        for (int col = 0; col < a.width; ++col) {
+            double dr = blurred_difference(col, row, 0);
+            double dg = blurred_difference(col, row, 1);
+            double db = blurred_difference(col, row, 2);
+
+            // opponent channels, luminance matters most
+            double luminance = 0.2126 * dr + 0.7152 * dg + 0.0722 * db;
+            double red_green = dr - dg;
+            double blue_yellow = db - 0.5 * (dr + dg);
+
+            double e = std::sqrt(luminance * luminance + 0.25 * red_green * red_green + 0.25 * blue_yellow * blue_yellow);
+            e = std::min(e, 1.0);
+            sum += e;
+            worst = std::max(worst, e);
+        }
+    }
+
+    if (max_error)
+        *max_error = worst;
+    return sum / (double(a.width) * a.height);
+}
@@ -0,0 +1,318 @@
+
+
+#include "rtweekend.h"
+
+#include "scene.h"
+#include "renderer.h"
+
+#include "image_compare.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// usage: RayTracingInAWeekendTests [--update-references] [reference_dir]
+// reference_dir defaults to "references", relative to the working directory (the post build step runs from the project folder)
+// Release builds run the tests after every build ; in Debug the renders take minutes, run the executable by hand
+
+int failures = 0;
+
+void check(bool passed, const std::string& name)
+{
+	std::cout << (passed ? "  pass  " : "  FAIL  ") << name << '\n';
+	if (!passed)
+		++failures;
+}
+
+bool near(double a, double b, double eps = 1e-9)
+{
+	return std::fabs(a - b) <= eps;
+}
+
+bool near(const vec3& a, const vec3& b, double eps = 1e-9)
+{
+	return near(a.x(), b.x(), eps) && near(a.y(), b.y(), eps) && near(a.z(), b.z(), eps);
+}
+
+
+void test_sphere_hit()
+{
+	std::cout << "sphere::hit\n";
+	sphere s(point3(0, 0, -5), 1.0, make_shared<lambertian>(color(0.5, 0.5, 0.5)));
+	hit_record rec;
+
+	// straight through the center, nearest root is the front of the sphere
+	check(s.hit(ray(point3(0, 0, 0), vec3(0, 0, -1)), 0.001, infinity, rec), "hits through center");
+	check(near(rec.t, 4.0), "nearest root is the front surface");
+	check(near(rec.normal, vec3(0, 0, 1)) && rec.front_face, "outward normal on front face");
+
+	// t scales with the direction length, the hit point must not
+	check(s.hit(ray(point3(0, 0, 0), vec3(0, 0, -2)), 0.001, infinity, rec) && near(rec.t, 2.0) && near(rec.p, point3(0, 0, -4)), "unnormalized direction");
+
+	check(!s.hit(ray(point3(0, 0, 0), vec3(0, 1, 0)), 0.001, infinity, rec), "misses when pointing away");
+	check(!s.hit(ray(point3(0, 0, 0), vec3(0, 0, 1)), 0.001, infinity, rec), "misses when sphere is behind the ray");
+
+	// discriminant == 0, grazes the top of the sphere
+	check(s.hit(ray(point3(0, 1, 0), vec3(0, 0, -1)), 0.001, infinity, rec) && near(rec.t, 5.0), "tangent ray hits once");
+
+	// from inside only the far root is in range, the normal is flipped to face the ray
+	check(s.hit(ray(point3(0, 0, -5), vec3(0, 0, -1)), 0.001, infinity, rec) && near(rec.t, 1.0), "inside ray hits far side");
+	check(!rec.front_face && near(rec.normal, vec3(0, 0, 1)), "inside hit is back face with flipped normal");
+
+	// range limits
+	check(s.hit(ray(point3(0, 0, 0), vec3(0, 0, -1)), 4.5, infinity, rec) && near(rec.t, 6.0), "t_min skips the near root");
+	check(!s.hit(ray(point3(0, 0, 0), vec3(0, 0, -1)), 0.001, 3.9, rec), "t_max before both roots misses");
+}
+
+
+void test_reflect()
+{
+	std::cout << "reflect\n";
+	vec3 n(0, 1, 0);
+	check(near(reflect(vec3(1, -1, 0), n), vec3(1, 1, 0)), "45 degree reflection");
+	check(near(reflect(vec3(0, -1, 0), n), vec3(0, 1, 0)), "normal incidence bounces straight back");
+	check(near(reflect(vec3(1, 0, 0), n), vec3(1, 0, 0)), "grazing direction is unchanged");
+
+	vec3 v = unit_vector(vec3(0.3, -0.8, 0.5));
+	check(near(reflect(v, n).length(), 1.0), "keeps unit length");
+}
+
+
+void test_refract()
+{
+	std::cout << "refract\n";
+	vec3 n(0, 1, 0);
+	vec3 v = unit_vector(vec3(1, -1, 0));
+
+	check(near(refract(v, n, 1.0), v), "ratio 1 passes straight through");
+	check(near(refract(vec3(0, -1, 0), n, 1.0 / 1.5), vec3(0, -1, 0)), "normal incidence is not bent");
+
+	vec3 r = refract(v, n, 1.0 / 1.5);
+	check(near(r.length(), 1.0), "keeps unit length");
+	// snell: sin(theta') = ratio * sin(theta), sin is the length of the component along the surface
+	check(near(r.x(), (1.0 / 1.5) * v.x()) && r.y() < 0, "obeys snell's law");
+}
+
+
+void test_reflectance()
+{
+	std::cout << "dielectric::reflectance\n";
+	check(near(dielectric::reflectance(1.0, 1.5), 0.04), "head on glass reflects 4%");
+	check(near(dielectric::reflectance(0.0, 1.5), 1.0), "grazing angle reflects everything");
+	check(near(dielectric::reflectance(1.0, 1.0), 0.0), "matching index does not reflect");
+	check(near(dielectric::reflectance(0.5, 1.5), 0.04 + 0.96 / 32), "schlick's fifth power at 60 degrees");
+	check(near(dielectric::reflectance(1.0, 1.5), dielectric::reflectance(1.0, 1.0 / 1.5)), "same going in and out");
+
+	bool increasing = true;
+	for (double c = 1.0; c > 0.0; c -= 0.05)
+		increasing = increasing && dielectric::reflectance(c - 0.05, 1.5) >= dielectric::reflectance(c, 1.5);
+	check(increasing, "grows towards grazing angles");
+}
+
+
+void test_image_metrics()
+{
+	std::cout << "image metrics\n";
+	image a;
+	a.width = 4;
+	a.height = 4;
+	a.values.assign(4 * 4 * 3, 128);
+	image b = a;
+
+	check(rmse(a, b) == 0.0 && psnr(a, b) > 1000.0 && perceptual_error(a, b) == 0.0, "identical images have no error");
+
+	b.values[0] = 255;
+	double max_error = 0.0;
+	check(rmse(a, b) > 0.0 && perceptual_error(a, b, &max_error) > 0.0 && max_error > 0.0, "one changed pixel is detected");
+}
+
+
+// Renders of random_scene() compared against converged (reference_spp) renders stored in reference_dir
+// the test renders use far fewer samples, so they differ from the reference by noise no matter how they are seeded ;
+// the tolerances sit above that noise floor (measured over many seeds), so a new sampler, a different random sequence
+// or float math that flips a few samples still passes, while a change to what the image converges to does not
+const int reference_spp = 1024;
+const int test_spp = 128;
+
+struct regression_case {
+	std::string name;
+	render_job job;
+};
+
+framebuffer render_framebuffer(const hittable& world, const render_job& job)
+{
+	framebuffer fb(job.image_width, job.image_height());
+	camera cam = job.make_camera();
+
+	// every row is seeded on its own, so splitting them over threads gives the same image
+	unsigned int thread_count = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::thread> workers;
+	for (unsigned int t = 0; t < thread_count; ++t)
+		workers.emplace_back([&, t]() {
+			for (int row = static_cast<int>(t); row < fb.height; row += static_cast<int>(thread_count))
+				render_row(world, cam, job, fb, row);
+		});
+	for (auto& worker : workers)
+		worker.join();
+
+	if (job.denoise)
+		denoiser().apply(fb);
+	return fb;
+}
+
+// goes through the same ppm writer as the renderer, so the test compares exactly what would be written to disk
+image to_image(const framebuffer& fb)
+{
+	std::stringstream ppm;
+	write_ppm(ppm, fb);
+	image img;
+	read_ppm(ppm, img);
+	return img;
+}
+
+bool load_reference(const std::string& path, const framebuffer& like, image& reference)
+{
+	std::ifstream in(path);
+	return read_ppm(in, reference) && reference.width == like.width && reference.height == like.height;
+}
+
+std::vector<regression_case> regression_cases()
+{
+	render_job base;
+	base.image_width = 90;
+	base.max_depth = 10;
+
+	std::vector<regression_case> cases;
+	cases.push_back({ "default_view", base });
+
+	regression_case side{ "side_view", base };
+	side.job.lookfrom = point3(-3, 2, 13);
+	side.job.vfov = 30;
+	cases.push_back(side);
+
+	// centered on the three big spheres, so the glass and the mirror take up much of the frame
+	regression_case closeup{ "big_spheres", base };
+	closeup.job.lookfrom = point3(6, 1.5, 7);
+	closeup.job.lookat = point3(0, 1, 0);
+	closeup.job.vfov = 35;
+	closeup.job.aperture = 0.0;
+	cases.push_back(closeup);
+
+	return cases;
+}
+
+void test_regression(const hittable& world, const std::string& reference_dir, bool update)
+{
+	std::cout << "regression renders\n";
+
+	for (const regression_case& c : regression_cases()) {
+		std::string path = reference_dir + "/" + c.name + ".ppm";
+
+		if (update) {
+			render_job job = c.job;
+			job.samples_per_pixel = reference_spp;
+			std::ofstream out(path);
+			write_ppm(out, render_framebuffer(world, job));
+			check(bool(out), c.name + ": wrote " + path);
+			continue;
+		}
+
+		render_job job = c.job;
+		job.samples_per_pixel = test_spp;
+		job.seed = 1;
+		framebuffer fb = render_framebuffer(world, job);
+
+		image reference;
+		if (!load_reference(path, fb, reference)) {
+			check(false, c.name + ": could not read " + path);
+			continue;
+		}
+
+		image rendered = to_image(fb);
+		double max_error = 0.0;
+		double e = rmse(rendered, reference);
+		double p = psnr(rendered, reference);
+		double flip = perceptual_error(rendered, reference, &max_error);
+		double bias = mean_difference(rendered, reference);
+		std::cout << "        rmse " << e << "  psnr " << p << " dB  perceptual " << flip << " (max " << max_error << ")  mean difference " << bias << '\n';
+
+		// rmse is only printed, psnr is the same measure on a log scale
+		// psnr catches large local errors, the perceptual error blurs away most of the noise and sees smaller ones,
+		// and the mean over the whole image has almost no noise left, so it catches overall shifts in brightness or tint
+		// over 30 seeds the worst were 38.0 dB, 0.0036 and 0.0009 ; the mean difference is never zero, gamma makes noisy pixels darker on average
+		check(p >= 36.5, c.name + ": psnr >= 36.5 dB");
+		check(flip <= 0.0045, c.name + ": mean perceptual error <= 0.0045");
+		check(bias <= 0.0012, c.name + ": mean difference per channel <= 0.0012");
+	}
+}
+
+
+// The denoiser has to earn its keep: at low sample counts the filtered image must be closer to the converged
+// reference than the noisy one it started from, on both metrics
+void test_denoiser(const hittable& world, const std::string& reference_dir)
+{
+	std::cout << "denoiser\n";
+
+	for (const regression_case& c : regression_cases()) {
+		for (int spp : { 8, 16 }) {
+			render_job job = c.job;
+			job.samples_per_pixel = spp;
+			job.seed = 1;
+			framebuffer fb = render_framebuffer(world, job);
+
+			image reference;
+			if (!load_reference(reference_dir + "/" + c.name + ".ppm", fb, reference)) {
+				check(false, c.name + ": could not read reference");
+				continue;
+			}
+
+			image noisy = to_image(fb);
+			denoiser().apply(fb);
+			image denoised = to_image(fb);
+
+			double noisy_psnr = psnr(noisy, reference);
+			double denoised_psnr = psnr(denoised, reference);
+			double noisy_flip = perceptual_error(noisy, reference);
+			double denoised_flip = perceptual_error(denoised, reference);
+			std::cout << "        " << spp << " spp  psnr " << noisy_psnr << " -> " << denoised_psnr
+			          << " dB  perceptual " << noisy_flip << " -> " << denoised_flip << '\n';
+
+			std::string name = c.name + " at " + std::to_string(spp) + " spp";
+			check(denoised_psnr >= noisy_psnr + 0.5, name + ": denoised psnr at least 0.5 dB better");
+			check(denoised_flip < noisy_flip, name + ": denoised perceptual error lower");
+		}
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	bool update = false;
+	std::string reference_dir = "references";
+	for (int i = 1; i < argc; ++i) {
+		std::string arg = argv[i];
+		if (arg == "--update-references")
+			update = true;
+		else
+			reference_dir = arg;
+	}
+
+	test_sphere_hit();
+	test_reflect();
+	test_refract();
+	test_reflectance();
+	test_image_metrics();
+
+	seed_random(0);
+	hittable_list world = random_scene();
+	test_regression(world, reference_dir, update);
+	if (!update)
+		test_denoiser(world, reference_dir);
+
+	std::cout << (failures ? std::to_string(failures) + " check(s) failed\n" : std::string("All checks passed\n"));
+	return failures ? 1 : 0;
+}